@@ -1,22 +1,289 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+#include "proctable.h"
+#include "workingset.h"
+#include "util.h"
+
+/**
+ * Most page sizes the simulator will track at once, e.g. 4K, 2M and 1G
+ */
+#define MAX_PAGE_SIZES 3
+
+/**
+ * Buffer size of the stats stream, rows reach the file a megabyte at a time
+ */
+#define STATS_BUFFER_SIZE (1 << 20)
+
+/**
+ * Parses the -p argument, a comma separated list of page sizes such as
+ * 	"4096,2097152". The smallest size is the base page size, any larger
+ * 	sizes are huge page sizes that base pages can be promoted to.
+ * :param arg: The -p argument, commas are overwritten while splitting it
+ * :param page_sizes: Filled with the page sizes, smallest first
+ * :return: The number of page sizes parsed or -1 if the list is bad
+ */
+int parse_page_sizes(char *arg, long page_sizes[]) {
+    int count = 0;
+    char *token;
+    char *next;
+
+    if (arg == NULL)
+        return -1;
+
+    // split on every comma so empty fields are seen and rejected
+    for (token = arg; token != NULL; token = next) {
+        char *end;
+        long size;
+        int i;
+
+        next = strchr(token, ',');
+        if (next != NULL)
+            *next++ = '\0';
+
+        errno = 0;
+        size = strtol(token, &end, 10);
+        if (errno != 0 || end == token || *end != '\0')
+            return -1;
+
+        // every page size has to be a power of two
+        if (size <= 0 || (size & (size - 1)) != 0 || count == MAX_PAGE_SIZES)
+            return -1;
+
+        // insert in sorted order, rejecting duplicates
+        for (i = count; i > 0 && page_sizes[i - 1] > size; i--)
+            page_sizes[i] = page_sizes[i - 1];
+        if (i > 0 && page_sizes[i - 1] == size)
+            return -1;
+        page_sizes[i] = size;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * Parses a positive count given to an option
+ * :param arg: The option argument, may be NULL
+ * :return: The count or -1 if arg is not a positive number
+ */
+long parse_count(const char *arg) {
+    char *end;
+    long count;
+
+    if (arg == NULL)
+        return -1;
+
+    errno = 0;
+    count = strtol(arg, &end, 10);
+    if (errno != 0 || end == arg || *end != '\0' || count <= 0)
+        return -1;
+    return count;
+}
+
+/**
+ * Writes one csv row per process that referenced memory in the interval
+ * 	or still has pages in the working set window, then starts a new interval.
+ * 	Processes that reached their last reference are removed from procs.
+ * :param stats: Where the csv stream goes
+ * :param procs: The processes to report
+ * :param ws: The working set, torn down processes leave it
+ * :param ref: Index of the last reference in the interval
+ * :param live: Number of processes that have not reached their last reference
+ */
+void write_stats(FILE *stats, proctable *procs, workingset *ws, long ref, long live) {
+    size_t i;
+
+    for (i = 0; i < procs->cap; i++) {
+        proc *p = &procs->procs[i];
+
+        if (p->used != PROC_USED)
+            continue;
+        if (p->refs > 0 || p->wss > 0)
+            fprintf(stats, "%ld,%lu,%ld,%ld,%ld,%ld\n", ref, p->pid, p->refs, p->writes, p->wss, live);
+        p->refs = 0;
+        p->writes = 0;
+
+        // processes torn down during the interval are dropped once reported
+        if (p->last_ref <= ref) {
+            workingset_drop(ws, p);
+            proctable_remove(procs, p);
+        }
+    }
+}
+
+/**
+ * Errors returned by find_last_refs and finish_trace
+ */
+#define TRACE_OPEN_ERROR -1
+#define TRACE_MALFORMED -3
+#define TRACE_DECOMPRESS_ERROR -4
+#define TRACE_CHANGED -5
+
+/**
+ * Closes a trace after reading it. A truncated or corrupt compressed trace
+ * 	usually ends in a broken line, so a failed decompressor is reported
+ * 	ahead of the malformed line.
+ * :param trace: The trace to close
+ * :param status: The last value returned by trace_next_ref
+ * :return: 0 on success, TRACE_NO_DECOMPRESSOR, TRACE_DECOMPRESS_ERROR
+ * 				or TRACE_MALFORMED
+ */
+int finish_trace(trace_file *trace, int status) {
+    int closed = trace_close(trace);
+
+    if (closed == TRACE_NO_DECOMPRESSOR)
+        return TRACE_NO_DECOMPRESSOR;
+    if (closed == -1)
+        return TRACE_DECOMPRESS_ERROR;
+    if (status == -1)
+        return TRACE_MALFORMED;
+    return 0;
+}
+
+/**
+ * Reports a trace error and exits, does nothing if status is 0
+ * :param status: The value returned by find_last_refs or finish_trace
+ * :param path: The trace file
+ * :param num_refs: Number of references read before a malformed line
+ */
+void check_trace(int status, const char *path, long num_refs) {
+    switch (status) {
+        case TRACE_OPEN_ERROR:
+            fprintf(stderr, "Could not open trace file %s\n", path);
+            exit(-1);
+        case TRACE_MALFORMED:
+            fprintf(stderr, "Malformed trace line after reference %ld\n", num_refs);
+            exit(-1);
+        case TRACE_NO_DECOMPRESSOR:
+            fprintf(stderr, "Decompressor not found for trace file %s, install lz4 or zstd\n", path);
+            exit(-1);
+        case TRACE_DECOMPRESS_ERROR:
+            fprintf(stderr, "Could not decompress trace file %s\n", path);
+            exit(-1);
+        case TRACE_CHANGED:
+            fprintf(stderr, "Trace file %s changed while it was being simulated\n", path);
+            exit(-1);
+        default:
+            break;
+    }
+}
+
+/**
+ * Pre-pass over the trace that records the index of each process's last
+ * 	reference, counting from 1, so only one long per process is kept.
+ * 	The simulation then opens the trace a second time. Plain traces that
+ * 	cannot be opened twice, such as pipes, are the exception: their
+ * 	references are buffered in refs, which costs one trace_ref each.
+ * :param path: The trace file
+ * :param refs: Set to the buffered references or NULL if the trace can
+ * 				be reopened, freed by the caller
+ * :param num_refs: Set to the number of references read, on a malformed
+ * 				line this is the number read before it
+ * :param procs: Filled with every process in the trace
+ * :return: 0 on success, TRACE_OPEN_ERROR, TRACE_MALFORMED,
+ * 				TRACE_NO_DECOMPRESSOR or TRACE_DECOMPRESS_ERROR
+ */
+int find_last_refs(const char *path, trace_ref **refs, long *num_refs, proctable *procs) {
+    trace_file trace;
+    trace_ref ref;
+    long cap;
+    int status;
+
+    *refs = NULL;
+    *num_refs = 0;
+    if (trace_open(&trace, path) == -1)
+        return TRACE_OPEN_ERROR;
+
+    cap = 0;
+    while ((status = trace_next_ref(&trace, &ref)) == 1) {
+        if (!trace.seekable) {
+            if (*num_refs == cap) {
+                cap = cap == 0 ? 1024 : cap * 2;
+                *refs = (trace_ref *) checked_realloc(*refs, cap * sizeof(trace_ref));
+            }
+            (*refs)[*num_refs] = ref;
+        }
+        (*num_refs)++;
+        proctable_add(procs, ref.pid)->last_ref = *num_refs;
+    }
+
+    return finish_trace(&trace, status);
+}
+
 int main(int argc, char **argv) {
     int opt;
-    int page_size;
+    long page_size;
     int real_mem_size;
+    long page_sizes[MAX_PAGE_SIZES];
+    int num_page_sizes;
+    int i;
+    trace_file trace;
+    trace_ref *refs;
+    trace_ref ref;
+    long num_refs;
+    long num_writes;
+    long n;
+    int status;
+    long stats_interval;
+    long interval_refs;
+    long window;
+    FILE *stats;
+    FILE *summary;
+    proctable procs;
+    workingset ws;
+    proc *p;
+    long live_procs;
 
     page_size = 0;
     real_mem_size = 100;
+    num_page_sizes = 0;
+    stats_interval = 0;
+    window = 0;
+    stats = stdout;
 
     // get simulator params
-    while ((opt = getopt(argc, argv, ":p::m::")) != -1) {
+    while ((opt = getopt(argc, argv, ":p::m::i::w::o::")) != -1) {
         switch (opt) {
-            // user indicated a page size
+            // user indicated one or more page sizes
             case 'p':
-                page_size = (int)atol(optarg);
+                num_page_sizes = parse_page_sizes(optarg, page_sizes);
+                if (num_page_sizes == -1) {
+                    fprintf(stderr, "Page sizes must be distinct powers of two, at most %d of them\n", MAX_PAGE_SIZES);
+                    exit(-1);
+                }
+                page_size = page_sizes[0];
                 break;
             // user indicated a mem size
             case 'm':
                 real_mem_size = (int)atol(optarg);
                 break;
+            // user asked for stats every so many references
+            case 'i':
+                stats_interval = parse_count(optarg);
+                if (stats_interval == -1) {
+                    fprintf(stderr, "Stats interval must be a positive number of references\n");
+                    exit(-1);
+                }
+                break;
+            // user indicated the working set window tau, counted in each process's own references
+            case 'w':
+                window = parse_count(optarg);
+                if (window == -1) {
+                    fprintf(stderr, "Working set window must be a positive number of references\n");
+                    exit(-1);
+                }
+                break;
+            // user indicated where the stats go
+            case 'o':
+                if (optarg == NULL || (stats = fopen(optarg, "w")) == NULL) {
+                    fprintf(stderr, "Could not open stats file %s\n", optarg == NULL ? "" : optarg);
+                    exit(-1);
+                }
+                break;
             case ':':
                 exit(-1);
             default:
@@ -24,6 +291,93 @@ int main(int argc, char **argv) {
         }
     }
 
-    printf("Page size: %d\n", page_size);
-    printf("Real meme size: %d\n", real_mem_size);
+    // the trace file follows the options
+    if (optind >= argc) {
+        fprintf(stderr, "Usage: %s [-p page sizes] [-m mem size] [-i stats interval] [-w working set window] [-o stats file] tracefile\n       with -i and no -o the stats go to stdout and the summary to stderr\n", argv[0]);
+        exit(-1);
+    }
+    proctable_init(&procs);
+    status = find_last_refs(argv[optind], &refs, &num_refs, &procs);
+    check_trace(status, argv[optind], num_refs);
+    if (refs == NULL && trace_open(&trace, argv[optind]) == -1)
+        check_trace(TRACE_OPEN_ERROR, argv[optind], 0);
+    live_procs = (long)procs.count;
+
+    // per interval stats are written as csv, one row per process per interval,
+    // the working set window defaults to the stats interval. When they go to
+    // stdout the summary moves to stderr so stdout stays pure csv.
+    //
+    // Rows are written synchronously into a large stdio buffer. Formatting
+    // and writing them is a small part of the run next to the working set
+    // bookkeeping, so a writer thread would have little to hide.
+    summary = stdout;
+    if (stats_interval > 0) {
+        if (window == 0)
+            window = stats_interval;
+        workingset_init(&ws, window);
+        if (stats == stdout)
+            summary = stderr;
+        setvbuf(stats, NULL, _IOFBF, STATS_BUFFER_SIZE);
+        fprintf(stats, "ref,pid,refs,writes,wss,live\n");
+    }
+
+    num_writes = 0;
+    interval_refs = 0;
+    // replay the buffered references or stream the trace a second time
+    for (n = 1; ; n++) {
+        if (refs != NULL) {
+            if (n > num_refs)
+                break;
+            ref = refs[n - 1];
+        }
+        else if ((status = trace_next_ref(&trace, &ref)) != 1) {
+            break;
+        }
+
+        // a pid missing from procs was not there in the pre-pass
+        p = proctable_get(&procs, ref.pid);
+        if (p == NULL || n > num_refs)
+            check_trace(TRACE_CHANGED, argv[optind], 0);
+        num_writes += ref.write;
+
+        if (stats_interval > 0) {
+            p->refs++;
+            p->writes += ref.write;
+            workingset_add(&ws, p, ref.vpn);
+        }
+
+        // tear the process down at its last reference, with stats on it
+        // stays in procs until its final interval has been written
+        if (p->last_ref == n) {
+            live_procs--;
+            if (stats_interval == 0)
+                proctable_remove(&procs, p);
+        }
+
+        if (++interval_refs == stats_interval) {
+            write_stats(stats, &procs, &ws, n, live_procs);
+            interval_refs = 0;
+        }
+    }
+    if (refs == NULL) {
+        check_trace(finish_trace(&trace, status), argv[optind], n - 1);
+        if (n - 1 != num_refs)
+            check_trace(TRACE_CHANGED, argv[optind], 0);
+    }
+    // flush the last partial interval
+    if (stats_interval > 0) {
+        if (interval_refs > 0)
+            write_stats(stats, &procs, &ws, num_refs, live_procs);
+        workingset_free(&ws);
+    }
+    proctable_free(&procs);
+    free(refs);
+    if (stats != stdout)
+        fclose(stats);
+
+    fprintf(summary, "Page size: %ld\n", page_size);
+    for (i = 1; i < num_page_sizes; i++)
+        fprintf(summary, "Huge page size: %ld\n", page_sizes[i]);
+    fprintf(summary, "Real meme size: %d\n", real_mem_size);
+    fprintf(summary, "References: %ld (%ld writes)\n", num_refs, num_writes);
 }
@@ -0,0 +1,107 @@
+#include <stdlib.h>
+#include <string.h>
+#include "proctable.h"
+#include "util.h"
+
+/**
+ * Starting number of slots, always a power of two
+ */
+#define INITIAL_CAP 64
+
+/**
+ * Finds the slot holding pid, or the empty slot where it would go.
+ * 	Tombstones are probed past, never reused.
+ */
+static proc *find_slot(proc *procs, size_t cap, unsigned long pid) {
+	size_t index = hash_mix(pid) & (cap - 1);
+
+	while (procs[index].used != PROC_EMPTY && (procs[index].used == PROC_REMOVED || procs[index].pid != pid))
+		index = (index + 1) & (cap - 1);
+	return &procs[index];
+}
+
+/**
+ * Reinserts every process into a fresh table, dropping the tombstones.
+ * 	The table only doubles if live processes fill a quarter of it.
+ */
+static void rehash(proctable *table) {
+	size_t new_cap = table->count * 4 > table->cap ? table->cap * 2 : table->cap;
+	proc *new_procs = (proc *) checked_calloc(new_cap, sizeof(proc));
+	size_t i;
+
+	for (i = 0; i < table->cap; i++)
+		if (table->procs[i].used == PROC_USED)
+			*find_slot(new_procs, new_cap, table->procs[i].pid) = table->procs[i];
+
+	free(table->procs);
+	table->procs = new_procs;
+	table->cap = new_cap;
+	table->removed = 0;
+}
+
+void proctable_init(proctable *table) {
+	table->cap = INITIAL_CAP;
+	table->count = 0;
+	table->removed = 0;
+	table->procs = (proc *) checked_calloc(table->cap, sizeof(proc));
+}
+
+void proctable_free(proctable *table) {
+	size_t i;
+
+	for (i = 0; i < table->cap; i++)
+		if (table->procs[i].used == PROC_USED)
+			free(table->procs[i].window);
+	free(table->procs);
+	table->procs = NULL;
+	table->cap = 0;
+	table->count = 0;
+	table->removed = 0;
+}
+
+/**
+ * Looks up a process
+ * :param pid: The pid to look up
+ * :return: The process or NULL if pid is not in the table
+ */
+proc *proctable_get(proctable *table, unsigned long pid) {
+	proc *slot = find_slot(table->procs, table->cap, pid);
+
+	return slot->used == PROC_USED ? slot : NULL;
+}
+
+/**
+ * Looks up a process, adding it with zeroed statistics if it is new.
+ * 	The returned pointer is only valid until the next proctable_add.
+ * :param pid: The pid to look up
+ * :return: The process
+ */
+proc *proctable_add(proctable *table, unsigned long pid) {
+	proc *slot;
+
+	// keep live processes and tombstones at or below half the table
+	if ((table->count + table->removed + 1) * 2 > table->cap)
+		rehash(table);
+
+	slot = find_slot(table->procs, table->cap, pid);
+	if (slot->used == PROC_EMPTY) {
+		memset(slot, 0, sizeof(proc));
+		slot->pid = pid;
+		slot->used = PROC_USED;
+		table->count++;
+	}
+	return slot;
+}
+
+/**
+ * Removes a process, leaving a tombstone in its slot. Safe to call while
+ * 	walking the table since no other process moves.
+ * :param p: The process to remove, as returned by proctable_get or proctable_add
+ */
+void proctable_remove(proctable *table, proc *p) {
+	free(p->window);
+	p->window = NULL;
+	p->used = PROC_REMOVED;
+	table->count--;
+	table->removed++;
+}
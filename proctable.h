@@ -0,0 +1,49 @@
+#ifndef PROCTABLE_H
+#define PROCTABLE_H
+
+#include <stddef.h>
+
+/**
+ * States of a slot in the process table
+ */
+#define PROC_EMPTY 0
+#define PROC_USED 1
+#define PROC_REMOVED -1
+
+/**
+ * Per process state, keyed by pid. last_ref is the index of the process's
+ * 	final reference in the trace, counting from 1. window is a ring of the
+ * 	vpns of the process's last tau references, owned by the working set.
+ */
+typedef struct proc {
+	unsigned long pid;
+	long last_ref;
+	long refs;
+	long writes;
+	long wss;
+	unsigned long *window;
+	long window_len;
+	long window_cap;
+	long window_next;
+	int used;
+} proc;
+
+/**
+ * Open addressing hash table of processes. Removed processes leave a
+ * 	tombstone so the table can be walked and removed from at once.
+ */
+typedef struct proctable {
+	proc *procs;
+	size_t cap;
+	size_t count;
+	size_t removed;
+} proctable;
+
+void proctable_init(proctable *table);
+void proctable_free(proctable *table);
+
+proc *proctable_get(proctable *table, unsigned long pid);
+proc *proctable_add(proctable *table, unsigned long pid);
+void proctable_remove(proctable *table, proc *p);
+
+#endif
@@ -0,0 +1,253 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "trace.h"
+
+/**
+ * Longest trace line we accept, a line is "pid vpn" with an optional r/w flag
+ */
+#define MAX_TRACE_LINE 256
+
+/**
+ * Magic numbers at the start of lz4 and zstd frames
+ */
+static const unsigned char LZ4_MAGIC[4] = {0x04, 0x22, 0x4d, 0x18};
+static const unsigned char ZSTD_MAGIC[4] = {0x28, 0xb5, 0x2f, 0xfd};
+
+/**
+ * Starts a decompressor for path and reads its output through a pipe.
+ * 	The decompressor runs in its own process so decompression overlaps
+ * 	with parsing, the pipe and stdio buffers keep both sides busy.
+ * :param trace: Filled with the read end of the pipe and the child pid
+ * :param tool: The decompressor to run, lz4 or zstd
+ * :param path: The compressed trace file
+ * :return: 0 on success or -1 if the decompressor could not be started
+ */
+static int open_decompressor(trace_file *trace, const char *tool, const char *path) {
+	int fds[2];
+	pid_t pid;
+
+	if (pipe(fds) == -1)
+		return -1;
+
+	pid = fork();
+	if (pid == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+
+	if (pid == 0) {
+		// child, decompress to the write end of the pipe
+		close(fds[0]);
+		if (dup2(fds[1], STDOUT_FILENO) == -1)
+			_exit(127);
+		close(fds[1]);
+		execlp(tool, tool, "-dc", "--", path, (char *)NULL);
+		perror(tool);
+		_exit(127);
+	}
+
+	close(fds[1]);
+	trace->file = fdopen(fds[0], "r");
+	if (trace->file == NULL) {
+		close(fds[0]);
+		waitpid(pid, NULL, 0);
+		return -1;
+	}
+	trace->decompressor = pid;
+	return 0;
+}
+
+/**
+ * Opens a trace file. lz4 and zstd compressed traces are detected from
+ * 	their magic number and streamed through the matching decompressor,
+ * 	anything else is read as a plain text trace. Compressed traces have
+ * 	to be regular files since the decompressor reopens them by path,
+ * 	plain traces may also be pipes.
+ * :param trace: Filled with the open trace
+ * :param path: The trace file to open
+ * :return: 0 on success or -1 if the trace could not be opened
+ */
+int trace_open(trace_file *trace, const char *path) {
+	unsigned char magic[4];
+	size_t magic_len;
+
+	const char *tool = NULL;
+	int seekable;
+
+	trace->file = fopen(path, "r");
+	trace->decompressor = -1;
+	trace->pending_len = 0;
+	trace->pending_pos = 0;
+	if (trace->file == NULL)
+		return -1;
+
+	magic_len = fread(magic, 1, sizeof(magic), trace->file);
+	seekable = fseek(trace->file, 0, SEEK_SET) == 0;
+	trace->seekable = seekable;
+	if (magic_len == sizeof(magic) && memcmp(magic, LZ4_MAGIC, sizeof(magic)) == 0)
+		tool = "lz4";
+	else if (magic_len == sizeof(magic) && memcmp(magic, ZSTD_MAGIC, sizeof(magic)) == 0)
+		tool = "zstd";
+
+	if (tool != NULL) {
+		fclose(trace->file);
+		if (!seekable) {
+			fprintf(stderr, "Compressed trace %s must be a regular file, not a pipe\n", path);
+			return -1;
+		}
+		return open_decompressor(trace, tool, path);
+	}
+
+	// a pipe cannot be rewound, so parse the magic bytes before the rest of it
+	if (!seekable) {
+		memcpy(trace->pending, magic, magic_len);
+		trace->pending_len = magic_len;
+	}
+	return 0;
+}
+
+/**
+ * Closes a trace and reaps its decompressor if there is one. Compressed
+ * 	traces are read to the end first, even after a malformed line.
+ * :param trace: The trace to close
+ * :return: 0 on success, TRACE_NO_DECOMPRESSOR if lz4 or zstd could not
+ * 				be run or -1 if the decompressor failed
+ */
+int trace_close(trace_file *trace) {
+	char drain[4096];
+	int status;
+
+	// read the decompressor's output to the end so an early close cannot
+	// kill it with SIGPIPE, its exit status then says if the data was good
+	if (trace->decompressor != -1)
+		while (fread(drain, 1, sizeof(drain), trace->file) > 0)
+			;
+
+	fclose(trace->file);
+	if (trace->decompressor == -1)
+		return 0;
+
+	if (waitpid(trace->decompressor, &status, 0) == -1)
+		return -1;
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 127)
+		return TRACE_NO_DECOMPRESSOR;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return -1;
+	return 0;
+}
+
+/**
+ * Parses an unsigned decimal number at *pos and moves *pos past it.
+ * 	Signs are rejected since strtoul would silently wrap a negative number.
+ * :param pos: The position in the line to parse from
+ * :param value: Filled with the parsed number
+ * :return: 0 on success or -1 if there is no valid number at *pos
+ */
+static int parse_number(char **pos, unsigned long *value) {
+	char *end;
+
+	while (isspace((unsigned char)**pos))
+		(*pos)++;
+	if (!isdigit((unsigned char)**pos))
+		return -1;
+
+	errno = 0;
+	*value = strtoul(*pos, &end, 10);
+	if (errno != 0 || (*end != '\0' && !isspace((unsigned char)*end)))
+		return -1;
+
+	*pos = end;
+	return 0;
+}
+
+/**
+ * Reads the next line of a trace, starting with any pushed back bytes
+ * :param line: Filled with the line, MAX_TRACE_LINE bytes long
+ * :return: 1 if a line was read, 0 at the end of the trace
+ * 				or -1 if the line does not fit in the buffer
+ */
+static int read_line(trace_file *trace, char *line) {
+	size_t len = 0;
+	int c;
+
+	// take any pushed back bytes first, up to the end of their line
+	while (trace->pending_pos < trace->pending_len) {
+		line[len] = trace->pending[trace->pending_pos++];
+		if (line[len++] == '\n')
+			break;
+	}
+	line[len] = '\0';
+
+	if (len == 0 || line[len - 1] != '\n') {
+		if (fgets(line + len, MAX_TRACE_LINE - len, trace->file) == NULL && len == 0)
+			return 0;
+		len = strlen(line);
+	}
+
+	// a full buffer without a newline is only fine if the line ends right there
+	if (len == MAX_TRACE_LINE - 1 && line[len - 1] != '\n') {
+		c = fgetc(trace->file);
+		if (c != '\n' && c != EOF)
+			return -1;
+	}
+	return 1;
+}
+
+/**
+ * Reads the next reference from a text trace. Each line holds a pid and
+ * 	a vpn, optionally followed by a single r or w. References without a
+ * 	flag are treated as reads, which keeps the original trace format valid.
+ * 	Blank lines are skipped.
+ * :param trace: The open trace file
+ * :param ref: Filled with the reference that was read
+ * :return: 1 if a reference was read, 0 at the end of the trace
+ * 				or -1 if the line is malformed
+ */
+int trace_next_ref(trace_file *trace, trace_ref *ref) {
+	char line[MAX_TRACE_LINE];
+	char *pos;
+	int status;
+
+	do {
+		status = read_line(trace, line);
+		if (status != 1)
+			return status;
+
+		pos = line;
+		while (isspace((unsigned char)*pos))
+			pos++;
+	} while (*pos == '\0');
+
+	if (parse_number(&pos, &ref->pid) == -1 || parse_number(&pos, &ref->vpn) == -1)
+		return -1;
+
+	while (isspace((unsigned char)*pos))
+		pos++;
+
+	// the flag has to be a token of its own
+	ref->write = 0;
+	if (*pos != '\0') {
+		if (*pos == 'w' || *pos == 'W')
+			ref->write = 1;
+		else if (*pos != 'r' && *pos != 'R')
+			return -1;
+		pos++;
+		if (*pos != '\0' && !isspace((unsigned char)*pos))
+			return -1;
+	}
+
+	// nothing may follow the flag
+	while (isspace((unsigned char)*pos))
+		pos++;
+	if (*pos != '\0')
+		return -1;
+
+	return 1;
+}
@@ -0,0 +1,41 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * A single memory reference read from a trace file
+ */
+typedef struct trace_ref {
+	unsigned long pid;
+	unsigned long vpn;
+	int write;
+} trace_ref;
+
+/**
+ * Returned by trace_close when lz4 or zstd could not be run
+ */
+#define TRACE_NO_DECOMPRESSOR -2
+
+/**
+ * An open trace. Compressed traces are read from the pipe of a
+ * 	decompressor child process, decompressor is -1 otherwise.
+ * 	pending holds the magic bytes already read from a plain trace
+ * 	that could not be rewound, they are parsed before the rest of file.
+ * 	seekable is 0 for such a trace since it cannot be opened a second time.
+ */
+typedef struct trace_file {
+	FILE *file;
+	pid_t decompressor;
+	int seekable;
+	char pending[4];
+	size_t pending_len;
+	size_t pending_pos;
+} trace_file;
+
+int trace_open(trace_file *trace, const char *path);
+int trace_close(trace_file *trace);
+int trace_next_ref(trace_file *trace, trace_ref *ref);
+
+#endif
@@ -0,0 +1,47 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "util.h"
+
+/**
+ * Scrambles a key so that small, consecutive keys such as pids and vpns
+ * 	spread over the whole table. This is the murmur3 finalizer.
+ * :param key: The key to hash
+ * :return: The hash, callers mask it down to their table size
+ */
+size_t hash_mix(unsigned long key) {
+	unsigned long h = key;
+
+	h ^= h >> 16;
+	h *= 0x85ebca6bUL;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35UL;
+	h ^= h >> 16;
+	return (size_t)h;
+}
+
+/**
+ * calloc that exits when memory runs out, the simulator cannot carry on
+ * 	without its tables.
+ */
+void *checked_calloc(size_t count, size_t size) {
+	void *ptr = calloc(count, size);
+
+	if (ptr == NULL) {
+		fprintf(stderr, "Out of memory! Exiting...\n");
+		exit(EXIT_FAILURE);
+	}
+	return ptr;
+}
+
+/**
+ * realloc that exits when memory runs out, see checked_calloc
+ */
+void *checked_realloc(void *ptr, size_t size) {
+	ptr = realloc(ptr, size);
+
+	if (ptr == NULL) {
+		fprintf(stderr, "Out of memory! Exiting...\n");
+		exit(EXIT_FAILURE);
+	}
+	return ptr;
+}
@@ -0,0 +1,10 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#include <stddef.h>
+
+size_t hash_mix(unsigned long key);
+void *checked_calloc(size_t count, size_t size);
+void *checked_realloc(void *ptr, size_t size);
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include "workingset.h"
+#include "util.h"
+
+/**
+ * Starting number of page slots, always a power of two
+ */
+#define INITIAL_CAP 1024
+
+/**
+ * Hashes a page, mixing the pid in so processes sharing vpns do not collide
+ */
+static size_t hash_page(unsigned long pid, unsigned long vpn) {
+	return hash_mix(pid * 0x9e3779b1UL + vpn);
+}
+
+/**
+ * Finds the slot holding the page, or the empty slot where it would go.
+ * 	Slots with a count of zero are empty.
+ */
+static size_t find_slot(page_count *pages, size_t cap, unsigned long pid, unsigned long vpn) {
+	size_t index = hash_page(pid, vpn) & (cap - 1);
+
+	while (pages[index].count != 0 && (pages[index].pid != pid || pages[index].vpn != vpn))
+		index = (index + 1) & (cap - 1);
+	return index;
+}
+
+/**
+ * Doubles the page table and reinserts every page
+ */
+static void grow(workingset *ws) {
+	size_t new_cap = ws->cap * 2;
+	page_count *new_pages = (page_count *) checked_calloc(new_cap, sizeof(page_count));
+	size_t i;
+
+	for (i = 0; i < ws->cap; i++)
+		if (ws->pages[i].count != 0)
+			new_pages[find_slot(new_pages, new_cap, ws->pages[i].pid, ws->pages[i].vpn)] = ws->pages[i];
+
+	free(ws->pages);
+	ws->pages = new_pages;
+	ws->cap = new_cap;
+}
+
+/**
+ * Empties a slot with backward shift deletion, so lookups never need tombstones
+ */
+static void remove_slot(workingset *ws, size_t hole) {
+	size_t index = hole;
+
+	for (;;) {
+		size_t home;
+
+		index = (index + 1) & (ws->cap - 1);
+		if (ws->pages[index].count == 0)
+			break;
+
+		// move the entry back if the hole lies between its home and its slot
+		home = hash_page(ws->pages[index].pid, ws->pages[index].vpn) & (ws->cap - 1);
+		if (((index - home) & (ws->cap - 1)) >= ((index - hole) & (ws->cap - 1))) {
+			ws->pages[hole] = ws->pages[index];
+			hole = index;
+		}
+	}
+	ws->pages[hole].count = 0;
+	ws->count--;
+}
+
+/**
+ * Takes one occurrence of a page out of the counts
+ * :return: 1 if the page left the working set, else 0
+ */
+static int release_page(workingset *ws, unsigned long pid, unsigned long vpn) {
+	size_t slot = find_slot(ws->pages, ws->cap, pid, vpn);
+
+	if (--ws->pages[slot].count > 0)
+		return 0;
+	remove_slot(ws, slot);
+	return 1;
+}
+
+/**
+ * Sets up an empty working set
+ * :param tau: The window size in references of each process
+ */
+void workingset_init(workingset *ws, long tau) {
+	ws->tau = tau;
+	ws->cap = INITIAL_CAP;
+	ws->count = 0;
+	ws->pages = (page_count *) checked_calloc(ws->cap, sizeof(page_count));
+}
+
+void workingset_free(workingset *ws) {
+	free(ws->pages);
+	ws->pages = NULL;
+}
+
+/**
+ * Slides a process's window forward by one of its references and updates
+ * 	its working set size. The ring grows up to tau entries as the process
+ * 	runs, so short lived processes only use what they reference.
+ * :param p: The process that made the reference
+ * :param vpn: The page it referenced
+ */
+void workingset_add(workingset *ws, proc *p, unsigned long vpn) {
+	size_t slot;
+
+	if (p->window_len == ws->tau) {
+		// the oldest reference falls out once the window is full
+		if (release_page(ws, p->pid, p->window[p->window_next]))
+			p->wss--;
+		p->window[p->window_next] = vpn;
+		p->window_next = (p->window_next + 1) % ws->tau;
+	}
+	else {
+		if (p->window_len == p->window_cap) {
+			p->window_cap = p->window_cap == 0 ? 16 : p->window_cap * 2;
+			if (p->window_cap > ws->tau)
+				p->window_cap = ws->tau;
+			p->window = (unsigned long *) checked_realloc(p->window, p->window_cap * sizeof(unsigned long));
+		}
+		p->window[p->window_len++] = vpn;
+	}
+
+	if ((ws->count + 1) * 2 > ws->cap)
+		grow(ws);
+
+	slot = find_slot(ws->pages, ws->cap, p->pid, vpn);
+	if (ws->pages[slot].count++ == 0) {
+		ws->pages[slot].pid = p->pid;
+		ws->pages[slot].vpn = vpn;
+		ws->count++;
+		p->wss++;
+	}
+}
+
+/**
+ * Empties a process's window and frees it, used when the process is torn down
+ * :param p: The process to drop
+ */
+void workingset_drop(workingset *ws, proc *p) {
+	long i;
+
+	for (i = 0; i < p->window_len; i++)
+		release_page(ws, p->pid, p->window[i]);
+
+	free(p->window);
+	p->window = NULL;
+	p->window_len = 0;
+	p->window_cap = 0;
+	p->window_next = 0;
+	p->wss = 0;
+}
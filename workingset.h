@@ -0,0 +1,34 @@
+#ifndef WORKINGSET_H
+#define WORKINGSET_H
+
+#include <stddef.h>
+#include "proctable.h"
+
+/**
+ * How many times a page appears in its process's window
+ */
+typedef struct page_count {
+	unsigned long pid;
+	unsigned long vpn;
+	long count;
+} page_count;
+
+/**
+ * Denning working set W(t, tau) of each process, where t and tau count the
+ * 	process's own references. Each process keeps a ring of its last tau
+ * 	vpns and pages counts how often each (pid, vpn) appears in its ring,
+ * 	a page is in the working set while its count is above zero.
+ */
+typedef struct workingset {
+	long tau;
+	page_count *pages;
+	size_t cap;
+	size_t count;
+} workingset;
+
+void workingset_init(workingset *ws, long tau);
+void workingset_free(workingset *ws);
+void workingset_add(workingset *ws, proc *p, unsigned long vpn);
+void workingset_drop(workingset *ws, proc *p);
+
+#endif